@@ -44,6 +44,7 @@ const (
 	AppTreeStoreIDFilename       = "treeStoreID"
 	OverlayPreparedFilename      = "overlay-prepared"
 	PrivateUsersPreparedFilename = "private-users-prepared"
+	PhaseTimingDirname           = "timing"
 
 	PrepareLock = "prepareLock"
 
@@ -1095,6 +1095,9 @@ func (p *pod) getExitStatuses() (map[string]int, error) {
 
 	stats := make(map[string]int)
 	for _, name := range ls {
+		if name == common.PhaseTimingDirname {
+			continue
+		}
 		s, err := p.readIntFromFile(filepath.Join(statusDir, name))
 		if err != nil {
 			stderr.PrintE(fmt.Sprintf("unable to get status of app %q", name), err)
@@ -1105,6 +1108,43 @@ func (p *pod) getExitStatuses() (map[string]int, error) {
 	return stats, nil
 }
 
+// getPhaseTimings returns the phase timing records written by the pod's
+// stage1, keyed by record name. Each record is a list of "phase=microseconds"
+// lines. Stage1 only writes them when it runs in debug mode.
+func (p *pod) getPhaseTimings() (map[string][]string, error) {
+	statusDir, err := p.getStatusDir()
+	if err != nil {
+		return nil, errwrap.Wrap(errors.New("unable to get status directory"), err)
+	}
+	timingDir := filepath.Join(statusDir, common.PhaseTimingDirname)
+	dir, err := p.openFile(timingDir, syscall.O_RDONLY|syscall.O_DIRECTORY)
+	if err == syscall.ENOENT {
+		return nil, nil
+	}
+	if err != nil {
+		return nil, errwrap.Wrap(errors.New("unable to open phase timing directory"), err)
+	}
+	defer dir.Close()
+
+	ls, err := dir.Readdirnames(0)
+	if err != nil {
+		return nil, errwrap.Wrap(errors.New("unable to read phase timing directory"), err)
+	}
+
+	timings := make(map[string][]string)
+	for _, name := range ls {
+		b, err := p.readFile(filepath.Join(timingDir, name))
+		if err != nil {
+			stderr.PrintE(fmt.Sprintf("unable to get phase timing record %q", name), err)
+			continue
+		}
+		if s := strings.TrimSpace(string(b)); s != "" {
+			timings[name] = strings.Split(s, "\n")
+		}
+	}
+	return timings, nil
+}
+
 // sync syncs the pod data. By now it calls a syncfs on the filesystem
 // containing the pod's directory.
 func (p *pod) sync() error {
@@ -18,6 +18,7 @@ package main
 
 import (
 	"fmt"
+	"sort"
 
 	"github.com/hashicorp/errwrap"
 	"github.com/spf13/cobra"
@@ -114,6 +115,21 @@ func printStatus(p *pod) error {
 		for app, stat := range stats {
 			stdout.Printf("app-%s=%d", app, stat)
 		}
+
+		timings, err := p.getPhaseTimings()
+		if err != nil {
+			return err
+		}
+		records := make([]string, 0, len(timings))
+		for record := range timings {
+			records = append(records, record)
+		}
+		sort.Strings(records)
+		for _, record := range records {
+			for _, phase := range timings[record] {
+				stdout.Printf("timing-%s-%s", record, phase)
+			}
+		}
 	}
 	return nil
 }
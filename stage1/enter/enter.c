@@ -27,6 +27,8 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include "timing.h"
+
 #ifdef NO_SETNS_AVAILABLE
 
 #include <linux/unistd.h>
@@ -66,6 +68,7 @@ int main(int argc, char *argv[])
 	pid_t	child;
 	int	status;
 	int	root_fd;
+	timing_t timing;
 
 	int c;
 
@@ -104,10 +107,12 @@ int main(int argc, char *argv[])
 	}
 
 	root_fd = openpidfd(pid, "root");
+	timing_init(&timing, root_fd, "enter", appname);
 
 #define ns(_typ, _nam)							\
 	fd = openpidfd(pid, _nam);					\
-	pexit_if(setns(fd, _typ), "Unable to enter " _nam " namespace");
+	pexit_if(setns(fd, _typ), "Unable to enter " _nam " namespace");	\
+	timing_stamp(&timing, _nam);
 
 #if 0
 	/* TODO(vc): Nspawn isn't employing CLONE_NEWUSER, disabled for now */
@@ -125,11 +130,17 @@ int main(int argc, char *argv[])
 		"Unable to chroot");
 	pexit_if(close(root_fd) == -1,
 		"Unable to close root_fd");
+	timing_stamp(&timing, "chroot");
 
 	/* Fork is required to realize consequence of CLONE_NEWPID */
 	pexit_if(((child = fork()) == -1),
 		"Unable to fork");
 
+	if(child != 0) {
+		timing_stamp(&timing, "fork");
+		timing_write(&timing);
+	}
+
 /* some stuff make the argv->args copy less cryptic */
 #define ENTEREXEC_ARGV_FWD_OFFSET	8
 
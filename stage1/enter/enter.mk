@@ -4,6 +4,7 @@ ifneq ($(ETR_FLAVORS),)
 
 ASSCB_FLAVORS := $(ETR_FLAVORS)
 ASSCB_EXTRA_CFLAGS := $(RKT_DEFINES_FOR_ENTER)
+ASSCB_COMMON_HEADERS := timing.h
 
 $(foreach f,$(ASSCB_FLAVORS),$(eval STAGE1_ENTER_CMD_$f := /enter))
 
@@ -28,6 +28,7 @@
 #include <unistd.h>
 
 #include "elf.h"
+#include "timing.h"
 
 static int exit_err;
 #define exit_if(_cond, _fmt, _args...)				\
@@ -290,6 +291,8 @@ int main(int argc, char *argv[])
 	uid_t		uid;
 	gid_t		*gids;
 	size_t		n_gids;
+	timing_t	timing;
+	char		app[NAME_MAX];
 
 	exit_if(argc < 7,
 		"Usage: %s /path/to/root /work/directory /env/file uid gid[,gid...] [-e] /to/exec [args ...]", argv[0]);
@@ -303,19 +306,29 @@ int main(int argc, char *argv[])
 	args = &argv[optind+5];
 	exe = args[0];
 
+	/* the record is opened now, before chrooting into the app */
+	timing_app_name(root, app, sizeof(app));
+	timing_init(&timing, -1, entering ? "enterexec-enter" : "enterexec", app);
+
 	parse_gids(gid_str, &n_gids, &gids);
 
 	initialize_keep_env(keep_env_file, keep_env);
 	load_env(env_file, keep_env_file, entering);
+	timing_stamp(&timing, "env");
 
 	pexit_if(chroot(root) == -1, "Chroot \"%s\" failed", root);
 	pexit_if(chdir(cwd) == -1, "Chdir \"%s\" failed", cwd);
+	timing_stamp(&timing, "chroot");
 	pexit_if(gids[0] > 0 && setresgid(gids[0], gids[0], gids[0]) == -1,
 		"Setresgid \"%s\" failed", gid_str);
 	pexit_if(n_gids > 1 && setgroups(n_gids - 1, &gids[1]) == -1,
 		"Setgroups \"%s\" failed", gid_str);
 	pexit_if(uid > 0 && setresuid(uid, uid, uid) == -1,
 		"Setresuid \"%s\" failed", uid_str);
+	timing_stamp(&timing, "credentials");
+
+	/* the exec itself can't be timed from here, the record ends with it */
+	timing_write(&timing);
 
 	/* XXX(vc): note that since execvp() is happening post-chroot, the
 	 * app's environment settings correctly affect the PATH search.
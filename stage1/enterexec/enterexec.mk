@@ -1,3 +1,4 @@
 ASSCB_EXTRA_HEADERS := elf.h
+ASSCB_COMMON_HEADERS := timing.h
 
 include stage1/makelib/aci_simple_static_c_bin.mk
@@ -0,0 +1,124 @@
+// Copyright 2016 The rkt Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/* Optional phase timing for the stage1 C helpers.
+ *
+ * Timing is enabled only when stage1 init created TIMING_DIR (it does so in
+ * debug mode); otherwise timing_init() costs a failed open() and every other
+ * call returns immediately.  Each helper invocation writes one record,
+ * TIMING_DIR/<tool>-<app>, holding a "<phase>=<microseconds>" line per phase,
+ * measured with CLOCK_MONOTONIC since the previous stamp.  Timing is best
+ * effort: failures never make the helper fail.
+ *
+ * The record is opened by timing_init() so it can still be written after the
+ * caller chrooted away from the stage1 rootfs or dropped its privileges.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TIMING_DIR	"rkt/status/timing"
+#define TIMING_STAGE2	"/opt/stage2/"
+#define TIMING_ROOTFS	"/rootfs"
+
+typedef struct _timing_t {
+	int		fd;
+	struct timespec	last;
+	size_t		len;
+	char		buf[1024];
+} timing_t;
+
+/* Returns the app name in an "/opt/stage2/<app>/rootfs" path, or the path
+ * itself.  Slashes are replaced, the result is used as a file name. */
+static inline void timing_app_name(const char *root, char *name, size_t size)
+{
+	size_t	len, i;
+
+	if(strncmp(root, TIMING_STAGE2, strlen(TIMING_STAGE2)) == 0)
+		root += strlen(TIMING_STAGE2);
+	len = strlen(root);
+	if(len > strlen(TIMING_ROOTFS) &&
+	   strcmp(root + len - strlen(TIMING_ROOTFS), TIMING_ROOTFS) == 0)
+		len -= strlen(TIMING_ROOTFS);
+	if(len >= size)
+		len = size - 1;
+	for(i = 0; i < len; i++)
+		name[i] = root[i] == '/' ? '_' : root[i];
+	name[len] = '\0';
+}
+
+/* Starts timing the phases of tool working on app.  rootfd is the stage1
+ * rootfs TIMING_DIR is relative to, -1 meaning "/". */
+static inline void timing_init(timing_t *t, int rootfd, const char *tool, const char *app)
+{
+	char	path[PATH_MAX];
+	int	dirfd;
+
+	t->fd = -1;
+	t->len = 0;
+	clock_gettime(CLOCK_MONOTONIC, &t->last);
+
+	if(rootfd < 0)
+		dirfd = open("/" TIMING_DIR, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+	else
+		dirfd = openat(rootfd, TIMING_DIR, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+	if(dirfd == -1)
+		return;
+
+	if(snprintf(path, sizeof(path), "%s-%s", tool, app) < sizeof(path))
+		t->fd = openat(dirfd, path, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0644);
+	close(dirfd);
+}
+
+/* Records the time spent in phase, i.e. since the previous stamp. */
+static inline void timing_stamp(timing_t *t, const char *phase)
+{
+	struct timespec	now;
+	long long	usec;
+	int		n;
+
+	if(t->fd == -1)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	usec = (now.tv_sec - t->last.tv_sec) * 1000000LL +
+		(now.tv_nsec - t->last.tv_nsec) / 1000;
+	t->last = now;
+
+	n = snprintf(t->buf + t->len, sizeof(t->buf) - t->len,
+		     "%s=%lli\n", phase, usec);
+	if(n > 0 && n < sizeof(t->buf) - t->len)
+		t->len += n;
+}
+
+/* Writes out the record, the stamps are kept in memory until then. */
+static inline void timing_write(timing_t *t)
+{
+	int	errsv = errno;
+
+	if(t->fd == -1)
+		return;
+
+	if(write(t->fd, t->buf, t->len) == -1) {
+		/* best effort */
+	}
+	close(t->fd);
+	t->fd = -1;
+	errno = errsv;
+}
@@ -20,7 +20,6 @@ import (
 	"path/filepath"
 
 	"github.com/appc/spec/schema/types"
-	"github.com/coreos/go-systemd/unit"
 	"github.com/coreos/rkt/common"
 )
 
@@ -28,6 +27,7 @@ const (
 	// UnitsDir is the default path to systemd systemd unit directory
 	UnitsDir        = "/usr/lib/systemd/system"
 	envDir          = "/rkt/env" // TODO(vc): perhaps this doesn't belong in /rkt?
+	statusDir       = "/rkt/status"
 	defaultWantsDir = UnitsDir + "/default.target.wants"
 	socketsWantsDir = UnitsDir + "/sockets.target.wants"
 )
@@ -73,14 +73,16 @@ func ServiceWantPath(root string, appName types.ACName) string {
 	return filepath.Join(common.Stage1RootfsPath(root), defaultWantsDir, ServiceUnitName(appName))
 }
 
-// InstantiatedPrepareAppUnitName returns the systemd service unit name for prepare-app
-// instantiated for the given root.
-func InstantiatedPrepareAppUnitName(appName types.ACName) string {
-	// Naming respecting escaping rules, see systemd.unit(5) and systemd-escape(1)
-	escapedRoot := unit.UnitNamePathEscape(common.RelAppRootfsPath(appName))
-	return "prepare-app@" + escapedRoot + ".service"
+// PhaseTimingDirPath returns the path to the directory holding the timing
+// records of the stage1 helpers' phases.
+func PhaseTimingDirPath(root string) string {
+	return filepath.Join(common.Stage1RootfsPath(root), statusDir, common.PhaseTimingDirname)
 }
 
+// PrepareAppsUnitName is the systemd service unit preparing the minimum
+// environment of all the apps of the pod.
+const PrepareAppsUnitName = "prepare-apps.service"
+
 // SocketUnitName returns a systemd socket unit name for the given app name.
 func SocketUnitName(appName types.ACName) string {
 	return appName.String() + ".socket"
@@ -148,8 +148,22 @@ func WriteDefaultTarget(p *stage1commontypes.Pod) error {
 	return nil
 }
 
-// WritePrepareAppTemplate writes service unit files for preparing the pod's applications
-func WritePrepareAppTemplate(p *stage1commontypes.Pod) error {
+// EnablePhaseTiming creates the directory prepare-app, enterexec and enter
+// write the timing records of their phases to. They don't time anything
+// unless it exists.
+func EnablePhaseTiming(p *stage1commontypes.Pod) error {
+	return os.MkdirAll(PhaseTimingDirPath(p.Root), 0755)
+}
+
+// WritePrepareAppsService writes the service unit file preparing the minimum
+// environment of all the pod's applications. A single prepare-app process
+// handles all of them, computing what they have in common only once.
+func WritePrepareAppsService(p *stage1commontypes.Pod) error {
+	execStart := []string{"/prepare-app", "--batch"}
+	for _, ra := range p.Manifest.Apps {
+		execStart = append(execStart, filepath.Join("/", common.RelAppRootfsPath(ra.Name)))
+	}
+
 	opts := []*unit.UnitOption{
 		unit.NewUnitOption("Unit", "Description", "Prepare minimum environment for chrooted applications"),
 		unit.NewUnitOption("Unit", "DefaultDependencies", "false"),
@@ -157,15 +171,21 @@ func WritePrepareAppTemplate(p *stage1commontypes.Pod) error {
 		unit.NewUnitOption("Unit", "Requires", "systemd-journald.service"),
 		unit.NewUnitOption("Unit", "After", "systemd-journald.service"),
 		unit.NewUnitOption("Service", "Type", "oneshot"),
+		unit.NewUnitOption("Service", "RemainAfterExit", "yes"),
 		unit.NewUnitOption("Service", "Restart", "no"),
-		unit.NewUnitOption("Service", "ExecStart", "/prepare-app %I"),
+		unit.NewUnitOption("Service", "ExecStart", quoteExec(execStart)),
 		unit.NewUnitOption("Service", "User", "0"),
 		unit.NewUnitOption("Service", "Group", "0"),
 		unit.NewUnitOption("Service", "CapabilityBoundingSet", "CAP_SYS_ADMIN CAP_DAC_OVERRIDE"),
 	}
 
 	unitsPath := filepath.Join(common.Stage1RootfsPath(p.Root), UnitsDir)
-	file, err := os.OpenFile(filepath.Join(unitsPath, "prepare-app@.service"), os.O_WRONLY|os.O_CREATE, 0644)
+	return writeUnit(filepath.Join(unitsPath, PrepareAppsUnitName), opts)
+}
+
+// writeUnit serializes the given unit options into the unit file at path
+func writeUnit(path string, opts []*unit.UnitOption) error {
+	file, err := os.OpenFile(path, os.O_WRONLY|os.O_CREATE, 0644)
 	if err != nil {
 		return errwrap.Wrap(errors.New("failed to create service unit file"), err)
 	}
@@ -569,8 +589,8 @@ func appToSystemd(p *stage1commontypes.Pod, ra *schema.RuntimeApp, interactive b
 		opts = append(opts, unit.NewUnitOption("Unit", "Requires", SocketUnitName(appName)))
 	}
 
-	opts = append(opts, unit.NewUnitOption("Unit", "Requires", InstantiatedPrepareAppUnitName(appName)))
-	opts = append(opts, unit.NewUnitOption("Unit", "After", InstantiatedPrepareAppUnitName(appName)))
+	opts = append(opts, unit.NewUnitOption("Unit", "Requires", PrepareAppsUnitName))
+	opts = append(opts, unit.NewUnitOption("Unit", "After", PrepareAppsUnitName))
 
 	opts = append(opts, unit.NewUnitOption("Unit", "Requires", "sysusers.service"))
 	opts = append(opts, unit.NewUnitOption("Unit", "After", "sysusers.service"))
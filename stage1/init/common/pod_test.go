@@ -17,13 +17,16 @@ package common
 import (
 	"io/ioutil"
 	"os"
+	"path/filepath"
 	"regexp"
 	"testing"
 
+	"github.com/coreos/rkt/common"
 	stage1commontypes "github.com/coreos/rkt/stage1/common/types"
 
 	"github.com/appc/spec/schema"
 	"github.com/appc/spec/schema/types"
+	"github.com/coreos/go-systemd/unit"
 )
 
 const tstprefix = "pod-test"
@@ -173,3 +176,55 @@ func hasBindROArg(output []string) bool {
 	}
 	return false
 }
+
+// TestWritePrepareAppsService tests that a single prepare-app invocation is
+// generated for all the apps of the pod.
+func TestWritePrepareAppsService(t *testing.T) {
+	tmpDir, err := ioutil.TempDir("", tstprefix)
+	if err != nil {
+		t.Fatalf("error creating tempdir: %v", err)
+	}
+	defer os.RemoveAll(tmpDir)
+
+	unitsPath := filepath.Join(common.Stage1RootfsPath(tmpDir), UnitsDir)
+	if err := os.MkdirAll(unitsPath, 0755); err != nil {
+		t.Fatalf("error creating units dir: %v", err)
+	}
+
+	p := &stage1commontypes.Pod{
+		Manifest: &schema.PodManifest{
+			Apps: schema.AppList{
+				{Name: *types.MustACName("foo")},
+				{Name: *types.MustACName("bar")},
+			},
+		},
+		Root: tmpDir,
+	}
+	if err := WritePrepareAppsService(p); err != nil {
+		t.Fatalf("unexpected error: %v", err)
+	}
+
+	f, err := os.Open(filepath.Join(unitsPath, PrepareAppsUnitName))
+	if err != nil {
+		t.Fatalf("error opening unit file: %v", err)
+	}
+	defer f.Close()
+	opts, err := unit.Deserialize(f)
+	if err != nil {
+		t.Fatalf("error parsing unit file: %v", err)
+	}
+
+	expected := `"/prepare-app" "--batch" "/opt/stage2/foo/rootfs" "/opt/stage2/bar/rootfs"`
+	found := false
+	for _, o := range opts {
+		if o.Section == "Service" && o.Name == "ExecStart" {
+			found = true
+			if o.Value != expected {
+				t.Errorf("expected ExecStart `%v`, got `%v`", expected, o.Value)
+			}
+		}
+	}
+	if !found {
+		t.Errorf("no ExecStart in %s", PrepareAppsUnitName)
+	}
+}
@@ -550,11 +550,17 @@ func stage1() int {
 		return 1
 	}
 
-	if err = stage1initcommon.WritePrepareAppTemplate(p); err != nil {
-		log.PrintE("failed to write prepare-app service template", err)
+	if err = stage1initcommon.WritePrepareAppsService(p); err != nil {
+		log.PrintE("failed to write prepare-apps service", err)
 		return 1
 	}
 
+	if debug {
+		if err := stage1initcommon.EnablePhaseTiming(p); err != nil {
+			log.PrintE("warning: error enabling phase timing", err)
+		}
+	}
+
 	if err := stage1initcommon.SetJournalPermissions(p); err != nil {
 		log.PrintE("warning: error setting journal ACLs, you'll need root to read the pod journal", err)
 	}
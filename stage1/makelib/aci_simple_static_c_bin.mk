@@ -2,6 +2,9 @@
 #
 # ASSCB_EXTRA_HEADERS - additional local C headers used
 #
+# ASSCB_COMMON_HEADERS - C headers shared by the stage1 binaries (in
+# stage1/include) used
+#
 # ASSCB_FLAVORS - which flavors want this app, set to STAGE1_FLAVORS
 # if empty
 #
@@ -25,6 +28,8 @@ _ASSCB_PATH_ := $(lastword $(MAKEFILE_LIST))
 _ASSCB_NAME_ := $(patsubst %.mk,%,$(MK_FILENAME))
 # Path to built binary. Not the one in the ACI rootfs.
 _ASSCB_BINARY_ := $(TOOLSDIR)/$(_ASSCB_NAME_)
+# Directory of the C headers shared by the stage1 binaries.
+_ASSCB_COMMON_INCDIR_ := $(MK_TOPLEVEL_SRCDIR)/stage1/include
 
 ifeq ($(ASSCB_FLAVORS),)
 
@@ -36,9 +41,11 @@ endif
 
 # variables for build_static_c_bin.mk
 BSCB_BINARY := $(_ASSCB_BINARY_)
-BSCB_HEADERS := $(foreach h,$(ASSCB_EXTRA_HEADERS),$(MK_SRCDIR)/$h)
+BSCB_HEADERS := \
+	$(foreach h,$(ASSCB_EXTRA_HEADERS),$(MK_SRCDIR)/$h) \
+	$(foreach h,$(ASSCB_COMMON_HEADERS),$(_ASSCB_COMMON_INCDIR_)/$h)
 BSCB_SOURCES := $(MK_SRCDIR)/$(_ASSCB_NAME_).c
-BSCB_ADDITIONAL_CFLAGS := -Wall -Os $(ASSCB_EXTRA_CFLAGS)
+BSCB_ADDITIONAL_CFLAGS := -Wall -Os -I$(_ASSCB_COMMON_INCDIR_) $(ASSCB_EXTRA_CFLAGS)
 
 CLEAN_FILES += $(_ASSCB_BINARY_)
 
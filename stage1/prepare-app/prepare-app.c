@@ -12,19 +12,26 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#define _GNU_SOURCE
 #include <errno.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <sys/mount.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <getopt.h>
 #include <sys/vfs.h>
 #include <dirent.h>
 #include <inttypes.h>
 
+#include "timing.h"
+
 #define err_out(_fmt, _args...)						\
 		fprintf(stderr, "Error: " _fmt "\n", ##_args);
 static int exit_err;
@@ -59,6 +66,103 @@ static int exit_err;
 #define CGROUP2_SUPER_MAGIC 0x63677270
 #endif
 
+/* The new mount API (Linux 5.2+, mount_setattr() since 5.12) lets us work
+ * on detached mount trees and place them relative to an already opened
+ * directory, instead of having the kernel walk "root/target" from scratch
+ * for every mount(2) call. libc wrappers are not commonly available, so go
+ * through syscall(2). The syscall numbers are shared by all architectures.
+ */
+#ifndef __NR_open_tree
+#define __NR_open_tree		428
+#endif
+#ifndef __NR_move_mount
+#define __NR_move_mount		429
+#endif
+#ifndef __NR_fsopen
+#define __NR_fsopen		430
+#endif
+#ifndef __NR_fsconfig
+#define __NR_fsconfig		431
+#endif
+#ifndef __NR_fsmount
+#define __NR_fsmount		432
+#endif
+#ifndef __NR_mount_setattr
+#define __NR_mount_setattr	442
+#endif
+
+#ifndef OPEN_TREE_CLONE
+#define OPEN_TREE_CLONE		1
+#endif
+#ifndef OPEN_TREE_CLOEXEC
+#define OPEN_TREE_CLOEXEC	O_CLOEXEC
+#endif
+#ifndef MOVE_MOUNT_F_EMPTY_PATH
+#define MOVE_MOUNT_F_EMPTY_PATH	0x00000004
+#endif
+#ifndef FSOPEN_CLOEXEC
+#define FSOPEN_CLOEXEC		0x00000001
+#endif
+#ifndef FSMOUNT_CLOEXEC
+#define FSMOUNT_CLOEXEC		0x00000001
+#endif
+#ifndef FSCONFIG_SET_STRING
+#define FSCONFIG_SET_STRING	1
+#define FSCONFIG_CMD_CREATE	6
+#endif
+#ifndef AT_RECURSIVE
+#define AT_RECURSIVE		0x8000
+#endif
+#ifndef MOUNT_ATTR_RDONLY
+#define MOUNT_ATTR_RDONLY	0x00000001
+#define MOUNT_ATTR_NOSUID	0x00000002
+#define MOUNT_ATTR_NODEV	0x00000004
+#define MOUNT_ATTR_NOEXEC	0x00000008
+#endif
+
+/* same layout as struct mount_attr from linux/mount.h */
+typedef struct _mount_attr_t {
+	uint64_t	attr_set;
+	uint64_t	attr_clr;
+	uint64_t	propagation;
+	uint64_t	userns_fd;
+} mount_attr_t;
+
+static int sys_open_tree(int dfd, const char *path, unsigned int flags)
+{
+	return syscall(__NR_open_tree, dfd, path, flags);
+}
+
+static int sys_move_mount(int from_dfd, const char *from_path,
+			  int to_dfd, const char *to_path, unsigned int flags)
+{
+	return syscall(__NR_move_mount, from_dfd, from_path,
+		       to_dfd, to_path, flags);
+}
+
+static int sys_mount_setattr(int dfd, const char *path, unsigned int flags,
+			     mount_attr_t *attr)
+{
+	return syscall(__NR_mount_setattr, dfd, path, flags,
+		       attr, sizeof(*attr));
+}
+
+static int sys_fsopen(const char *fsname, unsigned int flags)
+{
+	return syscall(__NR_fsopen, fsname, flags);
+}
+
+static int sys_fsconfig(int fd, unsigned int cmd, const char *key,
+			const void *value, int aux)
+{
+	return syscall(__NR_fsconfig, fd, cmd, key, value, aux);
+}
+
+static int sys_fsmount(int fd, unsigned int flags, unsigned int attr_flags)
+{
+	return syscall(__NR_fsmount, fd, flags, attr_flags);
+}
+
 typedef struct _dir_op_t {
 	const char	*name;
 	mode_t		mode;
@@ -72,6 +176,23 @@ typedef struct _mount_point_t {
 	unsigned long	flags;
 } mount_point;
 
+/* A directory mounts are made relative to: its path is kept for error
+ * messages and for the mount(2) fallback. */
+typedef struct _dir_fd_t {
+	const char	*path;
+	int		fd;
+} dir_fd_t;
+
+/* The host side of the mounts, i.e. the stage1 rootfs */
+static const dir_fd_t host = { "", AT_FDCWD };
+
+#define USAGE \
+	"Usage: %s --template | /path/to/root | --batch /path/to/root..."
+
+/* The pod-wide mount template, see prepare_template() */
+#define TEMPLATE_DIR	"/rkt/app-template"
+#define TEMPLATE_READY	"ready"
+
 #define dir(_name, _mode) \
 	{ .name = _name, .mode = _mode }
 
@@ -98,12 +219,16 @@ _fail:
 	return 0;
 }
 
-static int ensure_etc_hosts_exists(const char *root, int rootfd) {
+/* The /etc/hosts line is the same for all the apps of the pod, it is built
+ * at most once per process. */
+static char	hosts[128];
+static int	hosts_len;
+
+static int get_hosts_line(void) {
 	char	name[MACHINE_NAME_LEN + 1];
-	char	hosts[128];
-	int	fd, len;
+	int	len;
 
-	if(faccessat(rootfd, "etc/hosts", F_OK, AT_EACCESS) == 0)
+	if(hosts_len)
 		return 1;
 
 	goto_if(!get_machine_name(name, sizeof(name)),
@@ -113,6 +238,23 @@ static int ensure_etc_hosts_exists(const char *root, int rootfd) {
 			"127.0.0.1", name,
 			"localhost", "localhost.localdomain")) >= sizeof(hosts),
 		_fail, "/etc/hosts line too long: \"%s\"", hosts);
+	hosts_len = len;
+
+	return 1;
+
+_fail:
+	return 0;
+}
+
+static int ensure_etc_hosts_exists(const char *root, int rootfd) {
+	int	fd, len;
+
+	if(faccessat(rootfd, "etc/hosts", F_OK, AT_EACCESS) == 0)
+		return 1;
+
+	goto_if(!get_hosts_line(),
+		_fail, "Failed to build /etc/hosts line");
+	len = hosts_len;
 	pgoto_if((fd = openat(rootfd, "etc/hosts", O_WRONLY|O_CREAT, 0644)) == -1,
 		_fail, "Failed to create \"%s/etc/hosts\"", root);
 	pgoto_if(write(fd, hosts, len) != len,
@@ -128,19 +270,153 @@ _fail:
 	return 0;
 }
 
-static void mount_at(const char *root, const mount_point *mnt)
+/* Strip the leading slashes, so the path can be used with the *at()
+ * functions relative to a dir_fd_t. */
+static const char *rel(const char *path)
 {
-	char to[4096];
-	exit_if(snprintf(to, sizeof(to), "%s/%s", root, mnt->target) >= sizeof(to),
-		"Path too long: \"%s\"", to);
-	pexit_if(mount(mnt->source, to, mnt->type,
-		       mnt->flags, mnt->options) == -1,
-		 "Mounting \"%s\" on \"%s\" failed", mnt->source, to);
+	while (*path == '/')
+		path++;
+	return path;
 }
 
-static void mount_sys(const char *root)
+/* The attribute flags a bind mount can carry, which need to be applied with a
+ * separate remount (or mount_setattr()) after the bind itself. */
+#define MS_BIND_ATTRS	(MS_RDONLY|MS_NOSUID|MS_NODEV|MS_NOEXEC)
+
+static uint64_t ms_to_mount_attr(unsigned long flags)
 {
-	int i;
+	uint64_t attr = 0;
+
+	if (flags & MS_RDONLY)
+		attr |= MOUNT_ATTR_RDONLY;
+	if (flags & MS_NOSUID)
+		attr |= MOUNT_ATTR_NOSUID;
+	if (flags & MS_NODEV)
+		attr |= MOUNT_ATTR_NODEV;
+	if (flags & MS_NOEXEC)
+		attr |= MOUNT_ATTR_NOEXEC;
+	return attr;
+}
+
+/* Cleared as soon as the kernel (or a seccomp filter) turns down the new
+ * mount API, every later mount then goes straight to mount(2).
+ * mount_setattr() came later than open_tree() (Linux 5.12 vs 5.2), so it is
+ * tracked separately. */
+static int mount_api = 1;
+static int mount_setattr_api = 1;
+
+/* Apply the attribute flags of mnt with a bind remount of the already
+ * attached mnt->target. Unlike mount_setattr(), this only affects the top
+ * mount, even for recursive binds. */
+static int remount_attrs(const char *dst, const mount_point *mnt)
+{
+	return mount(NULL, dst, NULL,
+		     MS_REMOUNT|MS_BIND|(mnt->flags & MS_BIND_ATTRS), NULL);
+}
+
+/* Bind mount mnt->source, looked up in from, on mnt->target inside to.
+ * Returns 0 on success, -1 with errno set otherwise. */
+static int bind_at(const dir_fd_t *to, const dir_fd_t *from, const mount_point *mnt)
+{
+	char src[4096], dst[4096];
+	int fd;
+
+	if (snprintf(src, sizeof(src), "%s/%s", from->path, rel(mnt->source)) >= sizeof(src) ||
+	    snprintf(dst, sizeof(dst), "%s/%s", to->path, rel(mnt->target)) >= sizeof(dst)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	if (mount_api) {
+		unsigned int rec = (mnt->flags & MS_REC) ? AT_RECURSIVE : 0;
+		const char *source = mnt->source;
+
+		if (from->fd != AT_FDCWD)
+			source = rel(source);
+		fd = sys_open_tree(from->fd, source,
+				   OPEN_TREE_CLONE|OPEN_TREE_CLOEXEC|rec);
+		if (fd != -1) {
+			mount_attr_t attr = {
+				.attr_set = ms_to_mount_attr(mnt->flags),
+			};
+			int err = 0, remount = 0;
+
+			/* the clone is still detached: set the attributes
+			 * before it becomes visible in the app, on the whole
+			 * tree for recursive binds */
+			if (attr.attr_set) {
+				if (!mount_setattr_api ||
+				    sys_mount_setattr(fd, "", AT_EMPTY_PATH|rec, &attr) == -1) {
+					if (mount_setattr_api &&
+					    errno != ENOSYS && errno != EPERM)
+						err = errno;
+					mount_setattr_api = 0;
+					remount = 1;
+				}
+			}
+			if (!err &&
+			    sys_move_mount(fd, "", to->fd, rel(mnt->target),
+					   MOVE_MOUNT_F_EMPTY_PATH) == -1)
+				err = errno;
+			close(fd);
+			if (!err && remount && remount_attrs(dst, mnt) == -1)
+				err = errno;
+			errno = err;
+			return err ? -1 : 0;
+		}
+		if (errno != ENOSYS && errno != EPERM)
+			return -1;
+		mount_api = 0;
+	}
+
+	if (mount(src, dst, mnt->type, mnt->flags, mnt->options) == -1)
+		return -1;
+	if (mnt->flags & MS_BIND_ATTRS)
+		return remount_attrs(dst, mnt);
+	return 0;
+}
+
+static void mount_at(const dir_fd_t *to, const dir_fd_t *from, const mount_point *mnt)
+{
+	pexit_if(bind_at(to, from, mnt) == -1,
+		 "Mounting \"%s%s\" on \"%s/%s\" failed",
+		 from->path, mnt->source, to->path, rel(mnt->target));
+}
+
+/* Mount a fresh tmpfs on path, with fsopen() when the new mount API is
+ * usable. */
+static void mount_tmpfs(const char *path)
+{
+	int fsfd, mfd;
+
+	if (mount_api) {
+		if ((fsfd = sys_fsopen("tmpfs", FSOPEN_CLOEXEC)) != -1) {
+			pexit_if(sys_fsconfig(fsfd, FSCONFIG_SET_STRING, "mode", "0755", 0) == -1,
+				 "Configuring tmpfs for \"%s\" failed", path);
+			pexit_if(sys_fsconfig(fsfd, FSCONFIG_CMD_CREATE, NULL, NULL, 0) == -1,
+				 "Creating tmpfs for \"%s\" failed", path);
+			pexit_if((mfd = sys_fsmount(fsfd, FSMOUNT_CLOEXEC,
+						    MOUNT_ATTR_NOSUID|MOUNT_ATTR_NODEV)) == -1,
+				 "Creating tmpfs mount for \"%s\" failed", path);
+			pexit_if(sys_move_mount(mfd, "", AT_FDCWD, path,
+						MOVE_MOUNT_F_EMPTY_PATH) == -1,
+				 "Mounting tmpfs on \"%s\" failed", path);
+			close(mfd);
+			close(fsfd);
+			return;
+		}
+		pexit_if(errno != ENOSYS && errno != EPERM,
+			 "Opening tmpfs for \"%s\" failed", path);
+		mount_api = 0;
+	}
+
+	pexit_if(mount("tmpfs", path, "tmpfs", MS_NOSUID|MS_NODEV, "mode=0755") == -1,
+		 "Mounting tmpfs on \"%s\" failed", path);
+}
+
+static void mount_sys(const dir_fd_t *root, const dir_fd_t *src)
+{
+	int i, fd;
 	char to[4096];
 	struct statfs fs;
 	DIR *dir = NULL;
@@ -150,13 +426,32 @@ static void mount_sys(const char *root)
 		{ "/sys", "sys", "bind", NULL, MS_BIND },
 		{ "/sys/fs/cgroup", "sys/fs/cgroup", "bind", NULL, MS_BIND },
 	};
+	/* Same flags stage1 init uses for its own /sys and cgroup controllers,
+	 * see RemountCgroupsRO() */
+	const mount_point mnt_rec_ro = {
+		"/sys", "sys", "bind", NULL,
+		MS_BIND|MS_REC|MS_RDONLY|MS_NOSUID|MS_NODEV|MS_NOEXEC
+	};
+
+	if (src != &host) {
+		/* The template's /sys has already been set up below for this
+		 * host, without any of the per-app cgroup knobs stage1 init
+		 * bind mounts in its own /sys. So it can be bind mounted
+		 * recursively without the quadratic progression described
+		 * below, and made read-only in one go with mount_setattr().
+		 * On kernels without it, only the top /sys mount is
+		 * remounted, the rest keeps the flags of the stage1 mounts.
+		 */
+		mount_at(root, src, &mnt_rec_ro);
+		return;
+	}
 
 	pexit_if(statfs("/sys/fs/cgroup", &fs) != 0,
 	         "Cannot statfs /sys/fs/cgroup");
 	if (fs.f_type == (typeof(fs.f_type)) CGROUP2_SUPER_MAGIC) {
 		/* With the unified cgroup hierarchy, recursive bind mounts
 		 * are fine. */
-		mount_at(root, &mnt_rec);
+		mount_at(root, &host, &mnt_rec);
 		return;
 	}
 
@@ -184,7 +479,7 @@ static void mount_sys(const char *root)
 		// do a recursive bind mount if we are in a user namespace having a parent namespace set,
 		// i.e. either one of uid base, shift, or the range is set, see user_namespaces(7).
 		if (uid_base != 0 || uid_shift != 0 || uid_range != UNMAPPED) {
-			mount_at(root, &mnt_rec);
+			mount_at(root, &host, &mnt_rec);
 			return;
 		}
 	}
@@ -193,14 +488,18 @@ static void mount_sys(const char *root)
 	 * bind-mounts to control which files are read-only. To avoid
 	 * a quadratic progression, prepare-app does not bind mount
 	 * /sys recursively. See:
-	 * https://github.com/coreos/rkt/issues/2351 */
+	 * https://github.com/coreos/rkt/issues/2351
+	 * This is how the template's /sys is built, and the fallback
+	 * when an app is prepared without a template. */
 	for (i = 0; i < nelems(sys_bind_table); i++) {
-		mount_at(root, &sys_bind_table[i]);
+		mount_at(root, &host, &sys_bind_table[i]);
 	}
 
-	exit_if(snprintf(to, sizeof(to), "%s/%s", root, "sys/fs/cgroup") >= sizeof(to),
-		"Path too long: \"%s\"", to);
-	pexit_if(!(dir = opendir(to)), "Failed to open directory \"%s\"", to)
+	pexit_if((fd = openat(root->fd, "sys/fs/cgroup",
+			      O_RDONLY|O_DIRECTORY|O_CLOEXEC)) == -1,
+		 "Failed to open directory \"%s/sys/fs/cgroup\"", root->path);
+	pexit_if(!(dir = fdopendir(fd)),
+		 "Failed to open directory \"%s/sys/fs/cgroup\"", root->path);
 	errno = 0;
 	while ((d = readdir(dir))) {
 		if (d->d_type != DT_DIR)
@@ -210,66 +509,193 @@ static void mount_sys(const char *root)
 		if (strcmp(d->d_name, "..") == 0)
 			continue;
 
-		exit_if(snprintf(to, sizeof(to), "sys/fs/cgroup/%s", d->d_name) >= sizeof(to),
+		exit_if(snprintf(to, sizeof(to), "/sys/fs/cgroup/%s", d->d_name) >= sizeof(to),
 			"Path too long: \"%s\"", to);
 
 		mount_point mnt = { to, to, "bind", NULL, MS_BIND };
-		mount_at(root, &mnt);
+		mount_at(root, &host, &mnt);
 	}
-	pexit_if(errno != 0, "Failed to read directory \"%s\"", to);
+	pexit_if(errno != 0, "Failed to read directory \"%s/sys/fs/cgroup\"", root->path);
 	pexit_if(closedir(dir) != 0, "Failed to close directory");
 }
 
-int main(int argc, char *argv[])
+static const dir_op_t dirs[] = {
+	dir("dev",	0755),
+	dir("dev/net",	0755),
+	dir("dev/shm",	0755),
+	dir("etc",	0755),
+	dir("proc",	0755),
+	dir("sys",	0755),
+	dir("tmp",	01777),
+	dir("dev/pts",	0755),
+	dir("run",			0755),
+	dir("run/systemd",		0755),
+	dir("run/systemd/journal",	0755),
+};
+static const char *devnodes[] = {
+	"/dev/null",
+	"/dev/zero",
+	"/dev/full",
+	"/dev/random",
+	"/dev/urandom",
+	"/dev/tty",
+	"/dev/net/tun",
+	"/dev/console",
+	NULL
+};
+static const mount_point dirs_mount_table[] = {
+	{ "/proc", "/proc", "bind", NULL, MS_BIND|MS_REC },
+	{ "/dev/shm", "/dev/shm", "bind", NULL, MS_BIND },
+	{ "/dev/pts", "/dev/pts", "bind", NULL, MS_BIND },
+	{ "/run/systemd/journal", "/run/systemd/journal", "bind", NULL, MS_BIND },
+	/* /sys is handled separately */
+};
+static const mount_point files_mount_table[] = {
+	{ "/etc/rkt-resolv.conf", "/etc/resolv.conf", "bind", NULL, MS_BIND },
+};
+
+static void make_dirs(const dir_fd_t *root)
+{
+	int i;
+
+	umask(0);
+	for (i = 0; i < nelems(dirs); i++) {
+		const dir_op_t *d = &dirs[i];
+		pexit_if(mkdirat(root->fd, d->name, d->mode) == -1 &&
+			 errno != EEXIST,
+			"Failed to create directory \"%s/%s\"", root->path, d->name);
+	}
+}
+
+/* systemd-nspawn already creates few /dev entries in the container
+ * namespace: copy_devnodes()
+ * http://cgit.freedesktop.org/systemd/systemd/tree/src/nspawn/nspawn.c?h=v219#n1345
+ *
+ * But they are not visible by the apps because they are "protected" by
+ * the chroot.
+ *
+ * Bind mount them individually over the chroot border.
+ *
+ * Do NOT bind mount the whole directory /dev because it would shadow
+ * potential individual bind mount by stage0 ("rkt run --volume...").
+ *
+ * Do NOT use mknod, it would not work for /dev/console because it is
+ * a bind mount to a pts and pts device nodes only work when they live
+ * on a devpts filesystem.
+ */
+static void mount_devnodes(const dir_fd_t *root, const dir_fd_t *src)
+{
+	int i;
+
+	for (i = 0; devnodes[i]; i++) {
+		const char *from = devnodes[i];
+		const mount_point mnt = { from, from, "bind", NULL, MS_BIND };
+		int fd;
+
+		/* If the file does not exist, skip it. It might be because
+		 * the kernel does not provide it (e.g. kernel compiled without
+		 * CONFIG_TUN) or because systemd-nspawn does not provide it
+		 * (/dev/net/tun is not available with systemd-nspawn < v217
+		 */
+		if (faccessat(src->fd, src->fd == AT_FDCWD ? from : rel(from),
+			      F_OK, 0) != 0)
+			continue;
+
+		/* The mode does not matter: it will be bind-mounted over.
+		 */
+		fd = openat(root->fd, rel(from), O_WRONLY|O_CREAT|O_CLOEXEC|O_NOCTTY, 0644);
+		if (fd != -1)
+			close(fd);
+
+		mount_at(root, src, &mnt);
+	}
+}
+
+static void mount_dirs(const dir_fd_t *root, const dir_fd_t *src)
+{
+	int i;
+
+	for (i = 0; i < nelems(dirs_mount_table); i++) {
+		mount_at(root, src, &dirs_mount_table[i]);
+	}
+}
+
+/* Assemble the mounts every app of the pod gets (devnodes, /proc, /dev/shm,
+ * /dev/pts, the journal and /sys) once, in a private tmpfs at TEMPLATE_DIR.
+ * The per-app runs then clone each entry from there in a single operation,
+ * without probing the host paths or walking /sys/fs/cgroup again.
+ */
+static void prepare_template(void)
+{
+	dir_fd_t tmpl = { TEMPLATE_DIR, -1 };
+	timing_t timing;
+	int fd;
+
+	timing_init(&timing, -1, "prepare-app", "template");
+
+	pexit_if(mkdir(TEMPLATE_DIR, 0755) == -1 && errno != EEXIST,
+		 "Failed to create directory \"%s\"", TEMPLATE_DIR);
+	mount_tmpfs(TEMPLATE_DIR);
+	/* keep the template mounts from propagating anywhere */
+	pexit_if(mount(NULL, TEMPLATE_DIR, NULL, MS_PRIVATE, NULL) == -1,
+		 "Making \"%s\" private failed", TEMPLATE_DIR);
+	pexit_if((tmpl.fd = open(TEMPLATE_DIR, O_DIRECTORY|O_CLOEXEC)) == -1,
+		 "Failed to open directory \"%s\"", TEMPLATE_DIR);
+
+	timing_stamp(&timing, "tmpfs");
+
+	make_dirs(&tmpl);
+	timing_stamp(&timing, "mkdir");
+	mount_devnodes(&tmpl, &host);
+	timing_stamp(&timing, "devnodes");
+	mount_dirs(&tmpl, &host);
+	timing_stamp(&timing, "dir-mounts");
+	mount_sys(&tmpl, &host);
+	timing_stamp(&timing, "sys");
+
+	/* only now let the apps use it */
+	pexit_if((fd = openat(tmpl.fd, TEMPLATE_READY,
+			      O_WRONLY|O_CREAT|O_CLOEXEC, 0644)) == -1,
+		 "Failed to create \"%s/%s\"", TEMPLATE_DIR, TEMPLATE_READY);
+	pexit_if(close(fd) == -1,
+		 "Failed to close \"%s/%s\"", TEMPLATE_DIR, TEMPLATE_READY);
+	pexit_if(close(tmpl.fd) == -1,
+		 "Failed to close directory \"%s\"", TEMPLATE_DIR);
+
+	timing_write(&timing);
+}
+
+/* Open the template if it has been completely assembled, returns -1
+ * otherwise. */
+static int open_template(void)
+{
+	int fd;
+
+	if ((fd = open(TEMPLATE_DIR, O_DIRECTORY|O_CLOEXEC)) == -1)
+		return -1;
+	if (faccessat(fd, TEMPLATE_READY, F_OK, 0) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static void prepare_app(const char *path)
 {
 	static const char *unlink_paths[] = {
 		"dev/shm",
 		"dev/ptmx",
 		NULL
 	};
-	static const dir_op_t dirs[] = {
-		dir("dev",	0755),
-		dir("dev/net",	0755),
-		dir("dev/shm",	0755),
-		dir("etc",	0755),
-		dir("proc",	0755),
-		dir("sys",	0755),
-		dir("tmp",	01777),
-		dir("dev/pts",	0755),
-		dir("run",			0755),
-		dir("run/systemd",		0755),
-		dir("run/systemd/journal",	0755),
-	};
-	static const char *devnodes[] = {
-		"/dev/null",
-		"/dev/zero",
-		"/dev/full",
-		"/dev/random",
-		"/dev/urandom",
-		"/dev/tty",
-		"/dev/net/tun",
-		"/dev/console",
-		NULL
-	};
-	static const mount_point dirs_mount_table[] = {
-		{ "/proc", "/proc", "bind", NULL, MS_BIND|MS_REC },
-		{ "/dev/shm", "/dev/shm", "bind", NULL, MS_BIND },
-		{ "/dev/pts", "/dev/pts", "bind", NULL, MS_BIND },
-		{ "/run/systemd/journal", "/run/systemd/journal", "bind", NULL, MS_BIND },
-		/* /sys is handled separately */
-	};
-	static const mount_point files_mount_table[] = {
-		{ "/etc/rkt-resolv.conf", "/etc/resolv.conf", "bind", NULL, MS_BIND },
-	};
-	const char *root;
-	int rootfd;
-	char to[4096];
+	dir_fd_t root = { path, -1 };
+	dir_fd_t tmpl = { TEMPLATE_DIR, -1 };
+	const dir_fd_t *src = &host;
+	timing_t timing;
+	char app[NAME_MAX];
 	int i;
 
-	exit_if(argc < 2,
-		"Usage: %s /path/to/root", argv[0]);
-
-	root = argv[1];
+	timing_app_name(path, app, sizeof(app));
+	timing_init(&timing, -1, "prepare-app", app);
 
 	/* Make stage2's root a mount point. Chrooting an application in a
 	 * directory which is not a mount point is not nice because the
@@ -278,117 +704,186 @@ int main(int argc, char *argv[])
 	 * The recursive flag is to preserve volumes mounted previously by
 	 * systemd-nspawn via "rkt run -volume".
 	 * */
-	pexit_if(mount(root, root, "bind", MS_BIND | MS_REC, NULL) == -1,
+	pexit_if(mount(path, path, "bind", MS_BIND | MS_REC, NULL) == -1,
 			"Make / a mount point failed");
 
-	rootfd = open(root, O_DIRECTORY | O_CLOEXEC);
-	pexit_if(rootfd < 0,
-		"Failed to open directory \"%s\"", root);
+	/* Everything below is done relative to root.fd, so the kernel does not
+	 * have to walk the root path again for each entry. */
+	root.fd = open(path, O_DIRECTORY | O_CLOEXEC);
+	pexit_if(root.fd < 0,
+		"Failed to open directory \"%s\"", path);
+	timing_stamp(&timing, "root");
 
 	/* Some images have annoying symlinks that are resolved as dangling
 	 * links before the chroot in stage1. E.g. "/dev/shm" -> "/run/shm"
 	 * Just remove the symlinks.
          */
 	for (i = 0; unlink_paths[i]; i++) {
-		pexit_if(unlinkat(rootfd, unlink_paths[i], 0) != 0
+		pexit_if(unlinkat(root.fd, unlink_paths[i], 0) != 0
 			 && errno != ENOENT && errno != EISDIR,
 			 "Failed to unlink \"%s\"", unlink_paths[i])
 	}
+	timing_stamp(&timing, "unlink");
 
 	/* Create the directories */
-	umask(0);
-	for (i = 0; i < nelems(dirs); i++) {
-		const dir_op_t *d = &dirs[i];
-		pexit_if(mkdirat(rootfd, d->name, d->mode) == -1 &&
-			 errno != EEXIST,
-			"Failed to create directory \"%s/%s\"", root, d->name);
-	}
-
-	exit_if(!ensure_etc_hosts_exists(root, rootfd),
-		"Failed to ensure \"%s/etc/hosts\" exists", root);
-
-	close(rootfd);
-
-	/* systemd-nspawn already creates few /dev entries in the container
-	 * namespace: copy_devnodes()
-	 * http://cgit.freedesktop.org/systemd/systemd/tree/src/nspawn/nspawn.c?h=v219#n1345
-	 *
-	 * But they are not visible by the apps because they are "protected" by
-	 * the chroot.
-	 *
-	 * Bind mount them individually over the chroot border.
-	 *
-	 * Do NOT bind mount the whole directory /dev because it would shadow
-	 * potential individual bind mount by stage0 ("rkt run --volume...").
-	 *
-	 * Do NOT use mknod, it would not work for /dev/console because it is
-	 * a bind mount to a pts and pts device nodes only work when they live
-	 * on a devpts filesystem.
-	 */
-	for (i = 0; devnodes[i]; i++) {
-		const char *from = devnodes[i];
-		int fd;
-
-		/* If the file does not exist, skip it. It might be because
-		 * the kernel does not provide it (e.g. kernel compiled without
-		 * CONFIG_TUN) or because systemd-nspawn does not provide it
-		 * (/dev/net/tun is not available with systemd-nspawn < v217
-		 */
-		if (access(from, F_OK) != 0)
-			continue;
+	make_dirs(&root);
+	timing_stamp(&timing, "mkdir");
 
-		exit_if(snprintf(to, sizeof(to), "%s%s", root, from) >= sizeof(to),
-			"Path too long: \"%s\"", to);
+	exit_if(!ensure_etc_hosts_exists(path, root.fd),
+		"Failed to ensure \"%s/etc/hosts\" exists", path);
+	timing_stamp(&timing, "hosts");
 
-		/* The mode does not matter: it will be bind-mounted over.
-		 */
-		fd = open(to, O_WRONLY|O_CREAT|O_CLOEXEC|O_NOCTTY, 0644);
-		if (fd != -1)
-			close(fd);
+	if ((tmpl.fd = open_template()) != -1)
+		src = &tmpl;
 
-		pexit_if(mount(from, to, "bind", MS_BIND, NULL) == -1,
-				"Mounting \"%s\" on \"%s\" failed", from, to);
-	}
+	mount_devnodes(&root, src);
+	timing_stamp(&timing, "devnodes");
 
 	/* Bind mount directories */
-	for (i = 0; i < nelems(dirs_mount_table); i++) {
-		mount_at(root, &dirs_mount_table[i]);
-	}
+	mount_dirs(&root, src);
+	timing_stamp(&timing, "dir-mounts");
 
 	/* Bind mount /sys: handled differently, depending on cgroups */
-	mount_sys(root);
+	mount_sys(&root, src);
+	timing_stamp(&timing, "sys");
+
+	if (src == &tmpl)
+		close(tmpl.fd);
 
 	/* Bind mount files, if the source exists */
 	for (i = 0; i < nelems(files_mount_table); i++) {
 		const mount_point *mnt = &files_mount_table[i];
 		int fd;
 
-		exit_if(snprintf(to, sizeof(to), "%s/%s", root, mnt->target) >= sizeof(to),
-			"Path too long: \"%s\"", to);
 		if (access(mnt->source, F_OK) != 0)
 			continue;
-		if (access(to, F_OK) != 0) {
-			pexit_if((fd = creat(to, 0644)) == -1,
-				"Cannot create file: \"%s\"", to);
+		if (faccessat(root.fd, rel(mnt->target), F_OK, 0) != 0) {
+			pexit_if((fd = openat(root.fd, rel(mnt->target),
+					      O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0644)) == -1,
+				"Cannot create file: \"%s%s\"", path, mnt->target);
 			pexit_if(close(fd) == -1,
-				"Cannot close file: \"%s\"", to);
+				"Cannot close file: \"%s%s\"", path, mnt->target);
 		}
-		pexit_if(mount(mnt->source, to, mnt->type,
-			       mnt->flags, mnt->options) == -1,
-				"Mounting \"%s\" on \"%s\" failed", mnt->source, to);
+		mount_at(&root, &host, mnt);
 	}
+	timing_stamp(&timing, "files");
 
 	/* /dev/ptmx -> /dev/pts/ptmx */
-	exit_if(snprintf(to, sizeof(to), "%s/dev/ptmx", root) >= sizeof(to),
-		"Path too long: \"%s\"", to);
-	pexit_if(symlink("/dev/pts/ptmx", to) == -1 && errno != EEXIST,
+	pexit_if(symlinkat("/dev/pts/ptmx", root.fd, "dev/ptmx") == -1 && errno != EEXIST,
 		"Failed to create /dev/ptmx symlink");
 
 	/* /dev/log -> /run/systemd/journal/dev-log */
-	exit_if(snprintf(to, sizeof(to), "%s/dev/log", root) >= sizeof(to),
-		"Path too long: \"%s\"", to);
-	pexit_if(symlink("/run/systemd/journal/dev-log", to) == -1 && errno != EEXIST,
+	pexit_if(symlinkat("/run/systemd/journal/dev-log", root.fd, "dev/log") == -1 && errno != EEXIST,
 		"Failed to create /dev/log symlink");
 
+	pexit_if(close(root.fd) == -1,
+		"Failed to close directory \"%s\"", path);
+	timing_stamp(&timing, "symlinks");
+
+	timing_write(&timing);
+}
+
+/* Prepare all the given roots in one go: what all the apps have in common
+ * (the mount template, the /etc/hosts line) is computed once, then the roots
+ * are prepared by up to one child process per CPU. Children share the mount
+ * namespace, and an exit_if() in one of them only fails that root.
+ */
+static void prepare_batch(char *roots[], int n_roots)
+{
+	pid_t	*pids;
+	long	max_workers;
+	int	i, fd, n_running = 0, n_failed = 0;
+
+	if ((fd = open_template()) == -1)
+		prepare_template();
+	else
+		close(fd);
+	exit_if(!get_hosts_line(),
+		"Failed to build /etc/hosts line");
+
+	max_workers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (max_workers < 1)
+		max_workers = 1;
+	pexit_if((pids = calloc(n_roots, sizeof(*pids))) == NULL,
+		 "Unable to allocate pids");
+
+	for (i = 0; i < n_roots || n_running; ) {
+		pid_t	pid;
+		int	status, j;
+
+		if (i < n_roots && n_running < max_workers) {
+			pexit_if((pid = fork()) == -1,
+				 "Unable to fork");
+			if (pid == 0) {
+				prepare_app(roots[i]);
+				exit(EXIT_SUCCESS);
+			}
+			pids[i++] = pid;
+			n_running++;
+			continue;
+		}
+
+		pexit_if((pid = wait(&status)) == -1,
+			 "Unable to wait for children");
+		for (j = 0; j < i && pids[j] != pid; j++);
+		if (j == i)
+			continue;
+		n_running--;
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+			err_out("Preparing \"%s\" failed", roots[j]);
+			n_failed++;
+		}
+	}
+
+	free(pids);
+	exit_if(n_failed,
+		"Failed to prepare %i of %i roots", n_failed, n_roots);
+}
+
+int main(int argc, char *argv[])
+{
+	int template = 0, batch = 0;
+	int c;
+
+	while (1) {
+		int option_index = 0;
+		static struct option long_options[] = {
+		   {"template", no_argument, 0,  't' },
+		   {"batch",    no_argument, 0,  'b' },
+		   {0,          0,           0,  0 }
+		};
+
+		c = getopt_long(argc, argv, "tb",
+				long_options, &option_index);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 't':
+			template = 1;
+			break;
+		case 'b':
+			batch = 1;
+			break;
+		case 0:
+			break;
+		case '?':
+		default:
+			exit_if(1, USAGE, argv[0]);
+		}
+	}
+
+	if (template) {
+		prepare_template();
+		return EXIT_SUCCESS;
+	}
+
+	exit_if(optind >= argc, USAGE, argv[0]);
+
+	if (batch)
+		prepare_batch(&argv[optind], argc - optind);
+	else
+		prepare_app(argv[optind]);
+
 	return EXIT_SUCCESS;
 }
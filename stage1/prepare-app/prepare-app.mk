@@ -1 +1,3 @@
+ASSCB_COMMON_HEADERS := timing.h
+
 include stage1/makelib/aci_simple_static_c_bin.mk